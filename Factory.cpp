@@ -1,4 +1,9 @@
 #include "Factory.h"
+#include "MemoryAccounting.h"
+
+#include <cstring>
+#include <iterator>
+#include <mutex>
 
 #ifndef __clang__
 #include <cxxabi.h>
@@ -43,6 +48,20 @@ bool is_type_ancestor(const std::type_info& base, const std::type_info& deriv) {
     return false;
 }
 
+std::vector<std::type_info const*> type_ancestors(const std::type_info& deriv) {
+    std::vector<std::type_info const*> ancestors{&deriv};
+    if (auto si = dynamic_cast<__cxxabiv1::__si_class_type_info const*>(&deriv)) {
+        auto bases = type_ancestors(*si->__base_type);
+        ancestors.insert(ancestors.end(), bases.begin(), bases.end());
+    } else if (auto mi = dynamic_cast<__cxxabiv1::__vmi_class_type_info const*>(&deriv)) {
+        for (unsigned int i = 0; i < mi->__base_count; ++i) {
+            auto bases = type_ancestors(*mi->__base_info[i].__base_type);
+            ancestors.insert(ancestors.end(), bases.begin(), bases.end());
+        }
+    }
+    return ancestors;
+}
+
 #else // !HACK to satisfy clang (might not produce valid code)
 bool is_type_ancestor(const std::type_info& base, const std::type_info& deriv) {
     if (base == deriv) {
@@ -50,16 +69,194 @@ bool is_type_ancestor(const std::type_info& base, const std::type_info& deriv) {
     }
     return true;
 }
+std::vector<std::type_info const*> type_ancestors(const std::type_info& deriv) {
+    return {&deriv};
+}
 #endif
+
+namespace {
+// both are constant initialized, hence they can be used during static initialization of any binary
+StaticNodeBuilderSection* pendingSections {nullptr};
+bool registryCollected {false};
+thread_local NodeBuilders* captureTarget {nullptr};
+
+void addStaticNodeBuilders(NodeBuilders& registry, StaticNodeBuilderSection const& section) {
+    for (auto it = section.first; it != section.last; ++it) {
+        registry.emplace((*it)->getName(), *it);
+    }
+}
+
+struct NameLess {
+    static char const* name(char const* name) { return name; }
+    static char const* name(StaticNodeBuilder const* builder) { return builder->getName(); }
+
+    template<typename L, typename R>
+    bool operator()(L const& l, R const& r) const {
+        return std::strcmp(name(l), name(r)) < 0;
+    }
+};
+
+// the static builders of all sections sorted by name, guarded by the mutex of the registry
+// it is one array of pointers, the builders themselves get an entry in the registry only once they are selected
+std::vector<StaticNodeBuilder const*>& getStaticNodeBuilders() {
+    static std::vector<StaticNodeBuilder const*> builders = [] {
+        MemoryScope scope{MemoryScope::Unaccounted{}};
+        std::vector<StaticNodeBuilder const*> builders;
+        for (auto section = pendingSections; section; section = section->next) {
+            builders.insert(builders.end(), section->first, section->last);
+        }
+        std::stable_sort(builders.begin(), builders.end(), NameLess{});
+        registryCollected = true;
+        return builders;
+    }();
+    return builders;
+}
+
+void addStaticNodeBuilders(std::vector<StaticNodeBuilder const*>& builders, StaticNodeBuilderSection const& section) {
+    for (auto it = section.first; it != section.last; ++it) {
+        builders.insert(std::upper_bound(builders.begin(), builders.end(), *it, NameLess{}), *it);
+    }
+}
+}
+
+StaticNodeBuilderSection::StaticNodeBuilderSection(StaticNodeBuilder const* const* _first, StaticNodeBuilder const* const* _last)
+    : first{_first}
+    , last{_last}
+{
+    if (first == last) {
+        return;
+    }
+    if (captureTarget) {
+        addStaticNodeBuilders(*captureTarget, *this);
+    } else if (registryCollected) {
+        // a shared library that got loaded after the registry was used
+        std::unique_lock lock{NodeBuilderRegistry::getMutex()};
+        addStaticNodeBuilders(getStaticNodeBuilders(), *this);
+    } else {
+        next = pendingSections;
+        pendingSections = this;
+    }
+}
+
+NodeBuilders& registerNodeBuilder(std::string const& name, NodeBuilderBase const* builder) {
+    if (captureTarget) {
+        captureTarget->emplace(name, builder);
+        return *captureTarget;
+    }
+    auto& registry = NodeBuilderRegistry::getInstance();
+    std::unique_lock lock{NodeBuilderRegistry::getMutex()};
+    registry.emplace(name, builder);
+    return registry;
+}
+
+void unregisterNodeBuilder(NodeBuilders& builders, std::string const& name, NodeBuilderBase const* builder) {
+    std::unique_lock<std::shared_mutex> lock;
+    if (&builders == &NodeBuilderRegistry::getInstance()) {
+        lock = std::unique_lock{NodeBuilderRegistry::getMutex()};
+    }
+    auto [first, last] = builders.equal_range(name);
+    auto it = std::find_if(first, last, [builder](auto const& pair) { return pair.second == builder; });
+    if (it != last) {
+        builders.erase(it);
+    }
+}
+
+RegistrationCapture::RegistrationCapture(NodeBuilders& builders)
+    : previous{captureTarget}
+{
+    captureTarget = &builders;
+}
+
+RegistrationCapture::~RegistrationCapture() {
+    captureTarget = previous;
+}
+
+void selectNodeBuilder(NodeBuilders const& nodeBuilders, std::string const& name, NodeBuilderBase const* builder) {
+    auto& registry = NodeBuilderRegistry::getInstance();
+    if (&nodeBuilders != &registry or not dynamic_cast<StaticNodeBuilder const*>(builder)) {
+        return;
+    }
+    auto isBuilder = [builder](auto const& pair) { return pair.second == builder; };
+    {
+        std::shared_lock lock{NodeBuilderRegistry::getMutex()};
+        auto [first, last] = registry.equal_range(name);
+        if (std::find_if(first, last, isBuilder) != last) {
+            return;
+        }
+    }
+    std::unique_lock lock{NodeBuilderRegistry::getMutex()};
+    auto [first, last] = registry.equal_range(name);
+    if (std::find_if(first, last, isBuilder) == last) {
+        // a Tngl constructed inside the creation of a node must not charge the registry to that node
+        MemoryScope scope{MemoryScope::Unaccounted{}};
+        registry.emplace(name, builder);
+    }
+}
+}
+
+NodeBuilders& NodeBuilderRegistry::getInstance() {
+    static NodeBuilders instance;
+    return instance;
 }
+
+std::shared_mutex& NodeBuilderRegistry::getMutex() {
+    static std::shared_mutex mutex;
+    return mutex;
+}
+
+std::vector<std::pair<std::string, NodeBuilderBase const*>> findNodeBuilders(NodeBuilders const& nodeBuilders, LinkMatcher const& matcher) {
+    std::vector<std::pair<std::string, NodeBuilderBase const*>> found;
+    auto& registry = NodeBuilderRegistry::getInstance();
+    if (&nodeBuilders != &registry) {
+        if (matcher.isLiteral()) {
+            auto [first, last] = nodeBuilders.equal_range(matcher.getPattern());
+            found.assign(first, last);
+        } else {
+            std::copy_if(nodeBuilders.begin(), nodeBuilders.end(), std::back_inserter(found), [&](auto const& pair) {
+                return matcher.matches(pair.first);
+            });
+        }
+        return found;
+    }
+
+    std::shared_lock lock{NodeBuilderRegistry::getMutex()};
+    auto const& staticBuilders = detail::getStaticNodeBuilders();
+    // static builders in the registry are the selected ones, they are found through their section
+    auto isCandidate = [&](auto const& pair) {
+        return not dynamic_cast<StaticNodeBuilder const*>(pair.second) and matcher.matches(pair.first);
+    };
+    if (matcher.isLiteral()) {
+        auto [first, last] = registry.equal_range(matcher.getPattern());
+        std::copy_if(first, last, std::back_inserter(found), isCandidate);
+        auto name = matcher.getPattern().c_str();
+        auto [firstStatic, lastStatic] = std::equal_range(staticBuilders.begin(), staticBuilders.end(), name, detail::NameLess{});
+        for (; firstStatic != lastStatic; ++firstStatic) {
+            found.emplace_back(matcher.getPattern(), *firstStatic);
+        }
+        return found;
+    }
+    std::copy_if(registry.begin(), registry.end(), std::back_inserter(found), isCandidate);
+    auto registered = found.size();
+    for (auto builder : staticBuilders) {
+        if (matcher.matches(builder->getName())) {
+            found.emplace_back(builder->getName(), builder);
+        }
+    }
+    // both parts are ordered by name, registered builders go first for equal names
+    std::inplace_merge(found.begin(), found.begin() + registered, found.end(), [](auto const& l, auto const& r) {
+        return l.first < r.first;
+    });
+    return found;
+}
+
 Builders getBuildersForType(const std::type_info& base) {
-    auto const& reg = NodeBuilderRegistry::getInstance();
     Builders builders;
-    std::for_each(begin(reg), end(reg), [&](auto const& pair) {
-        if (detail::is_type_ancestor(base, pair.second->getType())) {
-            builders.emplace(pair.first, pair.second);
+    LinkMatcher const all{".*"};
+    for (auto const& [name, builder] : findNodeBuilders(NodeBuilderRegistry::getInstance(), all)) {
+        if (builder->canProduce(base)) {
+            builders.emplace(name, builder);
         }
-    });
+    }
     return builders;
 }
 
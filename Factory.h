@@ -1,58 +1,174 @@
 #pragma once
 
-#include "Singleton.h"
 #include "Node.h"
 
+#include <algorithm>
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
+#include <shared_mutex>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 namespace tngl {
 
 struct NodeBuilderBase;
 
+namespace detail {
+bool is_type_ancestor(const std::type_info& base, const std::type_info& deriv);
+// deriv and all its base classes
+std::vector<std::type_info const*> type_ancestors(const std::type_info& deriv);
+
+template<typename T>
+Node* createNode() {
+    if constexpr (std::is_default_constructible_v<T>) {
+        return new T;
+    } else {
+        return nullptr;
+    }
+}
+}
+
 using NodeBuilders = std::multimap<std::string, NodeBuilderBase const*>;
-using NodeBuilderRegistry = Singleton<NodeBuilders>;
+
+// The builders of the process. Builders created at runtime are in it for their lifetime.
+// Static builders (see TNGL_NODE_BUILDER) stay in their sections and get an entry only once a Tngl selects them,
+// findNodeBuilders and getBuildersForType also search the sections. Plugins do not add to it, see detail::RegistrationCapture.
+struct NodeBuilderRegistry {
+    using value_type = NodeBuilders;
+    static value_type& getInstance();
+    // Tngls add selected static builders while other threads might read the registry, iterating it needs a shared lock
+    static std::shared_mutex& getMutex();
+};
+
+// the builders of nodeBuilders whose name matches matcher, ordered by name
+// for the NodeBuilderRegistry this includes the static builders that were not selected yet
+std::vector<std::pair<std::string, NodeBuilderBase const*>> findNodeBuilders(NodeBuilders const& nodeBuilders, LinkMatcher const& matcher);
+
+namespace detail {
+// adds builder to the builders that registrations of the current thread go to and returns those
+NodeBuilders& registerNodeBuilder(std::string const& name, NodeBuilderBase const* builder);
+void unregisterNodeBuilder(NodeBuilders& builders, std::string const& name, NodeBuilderBase const* builder);
+
+// gives a static builder that a Tngl selected from the NodeBuilderRegistry its entry
+void selectNodeBuilder(NodeBuilders const& nodeBuilders, std::string const& name, NodeBuilderBase const* builder);
+
+// while it is alive, builders that get registered by the current thread go to builders instead of the NodeBuilderRegistry
+// this keeps loading a library from writing to the registry while other threads read it
+struct RegistrationCapture {
+    explicit RegistrationCapture(NodeBuilders& builders);
+    ~RegistrationCapture();
+
+    RegistrationCapture(RegistrationCapture const&) = delete;
+    RegistrationCapture& operator=(RegistrationCapture const&) = delete;
+
+private:
+    NodeBuilders* previous;
+};
+}
 
 struct NodeBuilderBase {
+    virtual std::unique_ptr<Node> create() const = 0;
+    virtual std::type_info const& getType() const = 0;
+
+    // if the nodes created by this builder can be assigned to a link of type base
+    virtual bool canProduce(std::type_info const& base) const {
+        return detail::is_type_ancestor(base, getType());
+    }
+
+    // the links of the nodes this builder creates, nullopt if the builder does not declare them
+    virtual std::optional<LinkDeclarations> getLinkDeclarations() const {
+        return std::nullopt;
+    }
+
+    // the matchers of getLinkDeclarations() in the same order, nullptr if the builder does not keep them
+    virtual LinkMatcher const* const* getLinkMatchers() const {
+        return nullptr;
+    }
+
+protected:
+    constexpr NodeBuilderBase() = default;
+    ~NodeBuilderBase() = default;
+
+    NodeBuilderBase(NodeBuilderBase const&) = delete;
+    NodeBuilderBase& operator=(NodeBuilderBase const&) = delete;
+};
+
+// a builder that is in the NodeBuilderRegistry for its lifetime
+struct RegisteredNodeBuilder : NodeBuilderBase {
 
 private:
     std::string _name;
     std::type_info const& _info;
     std::function<std::unique_ptr<Node>()> _createFunc;
+    std::optional<std::vector<LinkDeclaration>> _links;
+    mutable detail::LinkMatcherCache _matchers;
+    // the registry or the builders of a RegistrationCapture
+    NodeBuilders* _registry {nullptr};
 
 public:
     template<typename Func>
-    NodeBuilderBase(std::string name, std::type_info const& info, Func f)
+    RegisteredNodeBuilder(std::string name, std::type_info const& info, Func f)
         : _name{std::move(name)}
         , _info{info}
         , _createFunc{[=] { return std::unique_ptr<Node>{f()}; }} {
-        NodeBuilderRegistry::getInstance().emplace(_name, this);
+        _registry = &detail::registerNodeBuilder(_name, this);
     }
 
-    NodeBuilderBase(NodeBuilderBase const&) = delete;
-    NodeBuilderBase& operator=(NodeBuilderBase const&) = delete;
-    ~NodeBuilderBase() {
-        NodeBuilderRegistry::getInstance().erase(_name);
+    template<typename Func>
+    RegisteredNodeBuilder(std::string name, std::type_info const& info, std::vector<LinkDeclaration> links, Func f)
+        : RegisteredNodeBuilder(std::move(name), info, f) {
+        _links = std::move(links);
     }
 
-    std::unique_ptr<Node> create() const {
+    virtual ~RegisteredNodeBuilder() {
+        _matchers.clear();
+        detail::unregisterNodeBuilder(*_registry, _name, this);
+    }
+
+    std::unique_ptr<Node> create() const override {
         return _createFunc();
     }
 
-    std::type_info const& getType() const {
+    std::string const& getName() const {
+        return _name;
+    }
+
+    std::type_info const& getType() const override {
         return _info;
     }
+
+    std::optional<LinkDeclarations> getLinkDeclarations() const override {
+        if (not _links) {
+            return std::nullopt;
+        }
+        return LinkDeclarations{_links->data(), _links->data() + _links->size()};
+    }
+
+    LinkMatcher const* const* getLinkMatchers() const override {
+        if (not _links) {
+            return nullptr;
+        }
+        return _matchers.get(*getLinkDeclarations());
+    }
+
+protected:
+    // for builders that create their nodes by overriding create()
+    RegisteredNodeBuilder(std::string name, std::type_info const& info)
+        : _name{std::move(name)}
+        , _info{info} {
+        _registry = &detail::registerNodeBuilder(_name, this);
+    }
 };
 
 template<typename T>
-struct NodeBuilder : NodeBuilderBase {
-    using NodeBuilderBase::NodeBuilderBase;
+struct NodeBuilder : RegisteredNodeBuilder {
+    using RegisteredNodeBuilder::RegisteredNodeBuilder;
 
     NodeBuilder(std::string const& name)
-        : NodeBuilderBase(name, typeid(T), []{
+        : RegisteredNodeBuilder(name, typeid(T), []{
             if constexpr (std::is_default_constructible_v<T>) {
                 return std::make_unique<T>();
             } else {
@@ -63,14 +179,139 @@ struct NodeBuilder : NodeBuilderBase {
 
     template <typename Func>
     NodeBuilder(std::string const& name, Func f)
-        : NodeBuilderBase(name, typeid(T), f)
+        : RegisteredNodeBuilder(name, typeid(T), f)
     {}
+
+    NodeBuilder(std::string const& name, std::vector<LinkDeclaration> links)
+        : RegisteredNodeBuilder(name, typeid(T), std::move(links), &detail::createNode<T>)
+    {}
+
+    template <typename Func>
+    NodeBuilder(std::string const& name, std::vector<LinkDeclaration> links, Func f)
+        : RegisteredNodeBuilder(name, typeid(T), std::move(links), f)
+    {}
+};
+
+// a builder that is constant initialized, it neither allocates nor registers anything before main
+// use TNGL_NODE_BUILDER to define one
+struct StaticNodeBuilder final : NodeBuilderBase {
+
+private:
+    char const* _name;
+    std::type_info const& _info;
+    Node* (*_createFunc)();
+    LinkDeclarations _links;
+    bool _declaresLinks;
+    detail::LinkMatcherCache* _matchers;
+
+public:
+    constexpr StaticNodeBuilder(char const* name, std::type_info const& info, Node* (*createFunc)())
+        : _name{name}
+        , _info{info}
+        , _createFunc{createFunc}
+        , _links{}
+        , _declaresLinks{false}
+        , _matchers{nullptr}
+    {}
+
+    // declares that the created nodes have exactly the links in links, which may be empty
+    // matchers keeps their compiled patterns, without it they are interned on every use
+    constexpr StaticNodeBuilder(char const* name, std::type_info const& info, Node* (*createFunc)(), LinkDeclarations links, detail::LinkMatcherCache* matchers = nullptr)
+        : _name{name}
+        , _info{info}
+        , _createFunc{createFunc}
+        , _links{links}
+        , _declaresLinks{true}
+        , _matchers{matchers}
+    {}
+
+    template<std::size_t N>
+    constexpr StaticNodeBuilder(char const* name, std::type_info const& info, Node* (*createFunc)(), LinkDeclaration const (&links)[N], detail::LinkMatcherCache* matchers = nullptr)
+        : StaticNodeBuilder(name, info, createFunc, LinkDeclarations{links, links + N}, matchers)
+    {}
+
+    std::unique_ptr<Node> create() const override {
+        return std::unique_ptr<Node>{_createFunc()};
+    }
+
+    char const* getName() const {
+        return _name;
+    }
+
+    std::type_info const& getType() const override {
+        return _info;
+    }
+
+    std::optional<LinkDeclarations> getLinkDeclarations() const override {
+        if (not _declaresLinks) {
+            return std::nullopt;
+        }
+        return _links;
+    }
+
+    LinkMatcher const* const* getLinkMatchers() const override {
+        if (not _matchers) {
+            return nullptr;
+        }
+        return _matchers->get(_links);
+    }
 };
 
 namespace detail {
-bool is_type_ancestor(const std::type_info& base, const std::type_info& deriv);
+
+// the static builders of one binary (the executable or a shared library)
+// binaries that define static builders must not be unloaded
+struct StaticNodeBuilderSection {
+    StaticNodeBuilder const* const* first;
+    StaticNodeBuilder const* const* last;
+    StaticNodeBuilderSection* next {nullptr};
+
+    StaticNodeBuilderSection(StaticNodeBuilder const* const* _first, StaticNodeBuilder const* const* _last);
+};
+
+}
 }
 
+// the linker provides these for the section of the binary that includes this header
+extern "C" {
+extern ::tngl::StaticNodeBuilder const* const __start_tngl_builders[] __attribute__((weak, visibility("hidden")));
+extern ::tngl::StaticNodeBuilder const* const __stop_tngl_builders[] __attribute__((weak, visibility("hidden")));
+}
+
+namespace tngl {
+namespace detail {
+// one per binary, it only hands the section to the registry and does not touch the builders
+inline StaticNodeBuilderSection staticNodeBuilderSection __attribute__((visibility("hidden"))) {__start_tngl_builders, __stop_tngl_builders};
+}
+
+#define TNGL_CONCAT_IMPL(a, b) a##b
+#define TNGL_CONCAT(a, b) TNGL_CONCAT_IMPL(a, b)
+
+// define a builder for the default constructible type T that creates nodes with the name name
+// the builder lives in the section tngl_builders, lookups read it from there and it gets a registry entry once it is selected
+#define TNGL_NODE_BUILDER(T, name) TNGL_NODE_BUILDER_IMPL(T, name, TNGL_CONCAT(tnglStaticNodeBuilder, __COUNTER__))
+#define TNGL_NODE_BUILDER_IMPL(T, name, id) \
+    static constexpr ::tngl::StaticNodeBuilder id{name, typeid(T), &::tngl::detail::createNode<T>}; \
+    TNGL_NODE_BUILDER_ENTRY(id)
+
+// like TNGL_NODE_BUILDER but also declares the links of T, e.g.
+// TNGL_NODE_BUILDER_WITH_LINKS(Foo, "foo", tngl::declareLink<Bar>("bar", tngl::Flags::CreateRequired, "bar.*"))
+#define TNGL_NODE_BUILDER_WITH_LINKS(T, name, ...) TNGL_NODE_BUILDER_WITH_LINKS_IMPL(T, name, TNGL_CONCAT(tnglStaticNodeBuilder, __COUNTER__), __VA_ARGS__)
+#define TNGL_NODE_BUILDER_WITH_LINKS_IMPL(T, name, id, ...) \
+    static constexpr ::tngl::LinkDeclaration TNGL_CONCAT(id, Links)[] = {__VA_ARGS__}; \
+    static ::tngl::detail::LinkMatcherCache TNGL_CONCAT(id, Matchers); \
+    static constexpr ::tngl::StaticNodeBuilder id{name, typeid(T), &::tngl::detail::createNode<T>, TNGL_CONCAT(id, Links), &TNGL_CONCAT(id, Matchers)}; \
+    TNGL_NODE_BUILDER_ENTRY(id)
+
+// like TNGL_NODE_BUILDER but declares that T has no links
+#define TNGL_NODE_BUILDER_WITHOUT_LINKS(T, name) TNGL_NODE_BUILDER_WITHOUT_LINKS_IMPL(T, name, TNGL_CONCAT(tnglStaticNodeBuilder, __COUNTER__))
+#define TNGL_NODE_BUILDER_WITHOUT_LINKS_IMPL(T, name, id) \
+    static constexpr ::tngl::StaticNodeBuilder id{name, typeid(T), &::tngl::detail::createNode<T>, ::tngl::LinkDeclarations{}}; \
+    TNGL_NODE_BUILDER_ENTRY(id)
+
+#define TNGL_NODE_BUILDER_ENTRY(id) \
+    __attribute__((used, section("tngl_builders"))) static ::tngl::StaticNodeBuilder const* const TNGL_CONCAT(id, Entry) = &id
+
 using Builders = NodeBuilderRegistry::value_type;
 Builders getBuildersForType(const std::type_info& base);
 
@@ -1,18 +1,138 @@
 #include "Link.h"
+#include "MemoryAccounting.h"
 #include "Node.h"
+#include "Singleton.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 
 namespace tngl {
 
+namespace {
+
+struct LinkMatchers {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<LinkMatcher>> matchers;
+};
+using LinkMatcherRegistry = Singleton<LinkMatchers>;
+
+}
+
+LinkMatcher::LinkMatcher(std::string const& _pattern)
+    : pattern(_pattern)
+    , literal(pattern.find_first_of(R"(\^$.|?*+()[]{})") == std::string::npos)
+{
+    if (not literal) {
+        regex = std::regex(pattern);
+    }
+}
+
+LinkMatcher const* LinkMatcher::intern(std::string const& pattern) {
+    // interned matchers are never freed, hence every thread can remember them without taking the lock again
+    thread_local std::unordered_map<std::string, LinkMatcher const*> known;
+    auto knownIt = known.find(pattern);
+    if (knownIt != known.end()) {
+        return knownIt->second;
+    }
+    // the registry and the thread's map outlive every node
+    MemoryScope scope{MemoryScope::Unaccounted{}};
+    auto& registry = LinkMatcherRegistry::getInstance();
+    std::lock_guard lock{registry.mutex};
+    auto it = registry.matchers.find(pattern);
+    if (it == registry.matchers.end()) {
+        if (registry.matchers.size() >= maxInterned) {
+            return nullptr;
+        }
+        // compile before inserting, an invalid pattern must not leave an entry behind
+        auto matcher = std::make_unique<LinkMatcher>(pattern);
+        matcher->interned = true;
+        it = registry.matchers.emplace(pattern, std::move(matcher)).first;
+    }
+    known.emplace(pattern, it->second.get());
+    return it->second.get();
+}
+
+std::size_t LinkMatcher::getInternedMemoryUsage() {
+    auto& registry = LinkMatcherRegistry::getInstance();
+    std::lock_guard lock{registry.mutex};
+    std::size_t usage {0};
+    for (auto const& [pattern, matcher] : registry.matchers) {
+        usage += detail::heapUsage(pattern) + matcher->getMemoryUsage();
+    }
+    return usage;
+}
+
+namespace detail {
+LinkMatcher const* const* LinkMatcherCache::get(LinkDeclarations declarations) {
+    if (auto cached = matchers.load(std::memory_order_acquire)) {
+        return cached;
+    }
+    // the cache lives as long as its builder
+    MemoryScope scope{MemoryScope::Unaccounted{}};
+    auto count = static_cast<std::size_t>(declarations.end() - declarations.begin());
+    std::unique_ptr<LinkMatcher const*[]> newMatchers{new LinkMatcher const*[count]};
+    for (std::size_t i = 0; i < count; ++i) {
+        std::string pattern = declarations.begin()[i].pattern;
+        if (pattern.empty()) {
+            pattern = ".*";
+        }
+        newMatchers[i] = LinkMatcher::intern(pattern);
+        if (not newMatchers[i]) {
+            newMatchers[i] = new LinkMatcher(pattern);
+        }
+    }
+    LinkMatcher const** expected {nullptr};
+    if (matchers.compare_exchange_strong(expected, newMatchers.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+        size = count;
+        return newMatchers.release();
+    }
+    // another thread was faster
+    for (std::size_t i = 0; i < count; ++i) {
+        if (not newMatchers[i]->isInterned()) {
+            delete newMatchers[i];
+        }
+    }
+    return expected;
+}
+
+void LinkMatcherCache::clear() {
+    auto cached = matchers.exchange(nullptr);
+    if (not cached) {
+        return;
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+        if (not cached[i]->isInterned()) {
+            delete cached[i];
+        }
+    }
+    delete[] cached;
+}
+}
+
+std::size_t LinkMatcher::getMemoryUsage() const {
+    return sizeof(*this) + detail::heapUsage(pattern);
+}
+
 LinkBase::LinkBase(Node* _owner, Flags _flags, std::string const& _regex)
     : flags(_flags)
-    , regexStr(_regex)
     , owner(_owner)
 {
-    if (regexStr == "") {
-        // default to a match all in other cases
-        regexStr = ".*";
+    // default to a match all in other cases
+    auto const& pattern = _regex == "" ? std::string{".*"} : _regex;
+    matcher = LinkMatcher::intern(pattern);
+    if (not matcher) {
+        matcher = new LinkMatcher(pattern);
+        ownsMatcher = true;
     }
-    regex = std::regex(regexStr);
+    owner->addLink(this);
+}
+
+LinkBase::LinkBase(Node* _owner, Flags _flags, LinkMatcher const& _matcher)
+    : flags(_flags)
+    , matcher(&_matcher)
+    , owner(_owner)
+{
     owner->addLink(this);
 }
 
@@ -22,18 +142,23 @@ LinkBase::LinkBase(LinkBase&& other) noexcept {
 
 LinkBase& LinkBase::operator=(LinkBase&& other) noexcept
 {
+    if (this == &other) {
+        return *this;
+    }
     if (owner) {
         owner->removeLink(this);
     }
-    
-    owner    = other.owner;
-    flags    = other.flags;
-    regexStr = std::move(other.regexStr);
-    regex    = std::move(other.regex);
+    if (ownsMatcher) {
+        delete matcher;
+    }
+
+    owner       = other.owner;
+    flags       = other.flags;
+    matcher     = std::exchange(other.matcher, nullptr);
+    ownsMatcher = std::exchange(other.ownsMatcher, false);
 
     if (owner) {
-        owner->addLink(this);
-        other.owner->removeLink(&other);
+        owner->replaceLink(&other, this);
         other.owner = nullptr;
     }
     return *this;
@@ -43,6 +168,16 @@ LinkBase::~LinkBase() {
     if (owner) {
         owner->removeLink(this);
     }
+    if (ownsMatcher) {
+        delete matcher;
+    }
+}
+
+std::size_t LinkBase::getMatcherMemoryUsage() const {
+    if (not ownsMatcher) {
+        return 0;
+    }
+    return matcher->getMemoryUsage();
 }
 
 }
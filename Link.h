@@ -1,8 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <functional>
 #include <map>
+#include <memory>
 #include <regex>
+#include <string>
 #include <typeinfo>
 #include <map>
 
@@ -23,6 +28,106 @@ constexpr Flags operator&(Flags const& l, Flags const& r) {
     return static_cast<Flags>(static_cast<int>(l) & static_cast<int>(r));
 }
 
+// describes a link of a node without the node, builders can declare them to allow planning without creating nodes
+struct LinkDeclaration {
+    char const* name;
+    char const* pattern;
+    Flags flags;
+    std::type_info const* type;
+    // a Links instead of a Link
+    bool multiple;
+};
+
+template<typename T=Node>
+constexpr LinkDeclaration declareLink(char const* name, Flags flags=Flags::Optional, char const* pattern=".*") {
+    return {name, pattern, flags, &typeid(T), false};
+}
+
+template<typename T=Node>
+constexpr LinkDeclaration declareLinks(char const* name, Flags flags=Flags::Optional, char const* pattern=".*") {
+    return {name, pattern, flags, &typeid(T), true};
+}
+
+struct LinkDeclarations {
+    LinkDeclaration const* first {nullptr};
+    LinkDeclaration const* last {nullptr};
+
+    LinkDeclaration const* begin() const { return first; }
+    LinkDeclaration const* end()   const { return last; }
+};
+
+// the compiled pattern of links, it is immutable and shared by all links with the same pattern
+struct LinkMatcher {
+private:
+    std::string pattern;
+    std::regex regex;
+    bool literal;
+    bool interned {false};
+
+public:
+    LinkMatcher(std::string const& _pattern);
+
+    // at most this many patterns are interned, patterns that contain names of per request nodes would grow it without bound
+    static constexpr std::size_t maxInterned = 4096;
+
+    // returns the matcher for pattern, matchers are compiled once and kept for the lifetime of the process
+    // returns nullptr if maxInterned patterns are interned already, the caller has to compile its own matcher then
+    static LinkMatcher const* intern(std::string const& pattern);
+
+    // bytes used by all interned matchers, like getMemoryUsage() without their compiled automatons
+    static std::size_t getInternedMemoryUsage();
+
+    bool matches(std::string const& name) const {
+        if (literal) {
+            return name == pattern;
+        }
+        return std::regex_match(name, regex);
+    }
+
+    bool matches(char const* name) const {
+        if (literal) {
+            return pattern == name;
+        }
+        return std::regex_match(name, regex);
+    }
+
+    std::string const& getPattern() const {
+        return pattern;
+    }
+
+    // a pattern without any special characters only matches the string itself
+    bool isLiteral() const {
+        return literal;
+    }
+
+    bool isInterned() const {
+        return interned;
+    }
+
+    // bytes used by this object and its pattern
+    // it excludes the compiled automaton of a regex pattern since std::regex does not expose its size, literal patterns have none
+    std::size_t getMemoryUsage() const;
+};
+
+namespace detail {
+// the matchers of the link declarations of one builder, they are interned on first use
+// it is trivially destructible to keep static builders free of static destructors, other owners call clear()
+struct LinkMatcherCache {
+    constexpr LinkMatcherCache() = default;
+    LinkMatcherCache(LinkMatcherCache const&) = delete;
+    LinkMatcherCache& operator=(LinkMatcherCache const&) = delete;
+
+    // the matchers of declarations in the same order, declarations must be the same on every call
+    // they live until clear() is called
+    LinkMatcher const* const* get(LinkDeclarations declarations);
+    void clear();
+
+private:
+    std::atomic<LinkMatcher const**> matchers {nullptr};
+    std::size_t size {0};
+};
+}
+
 struct LinkBase {
     LinkBase(Node* owner, Flags _flags=Flags::Optional, std::string const& _regex="");
 
@@ -37,27 +142,68 @@ struct LinkBase {
     virtual void setOther(Node* other, std::string const& name) = 0;
     virtual bool satisfied() const = 0;
 
+    // if it can be set to more than one node
+    virtual bool acceptsMultiple() const {
+        return false;
+    }
+
     virtual bool isConnectedTo(Node const*) const = 0;
 
     bool matchesName(std::string const& name) const {
-        return std::regex_match(name, regex);
+        return matcher->matches(name);
     }
 
     virtual std::type_info const& getType() const = 0;
 
     std::string const& getRegex() const {
-        return regexStr;
+        return matcher->getPattern();
+    }
+
+    LinkMatcher const& getMatcher() const {
+        return *matcher;
+    }
+
+    // approximate number of bytes used by this link including a matcher that only this link uses
+    // interned matchers are shared by the process, see LinkMatcher::getInternedMemoryUsage()
+    // neither includes the compiled automaton of regex patterns, see LinkMatcher::getMemoryUsage()
+    virtual std::size_t getMemoryUsage() const {
+        return sizeof(LinkBase) + getMatcherMemoryUsage();
     }
+
 protected:
+    // for links whose matcher outlives them
+    LinkBase(Node* owner, Flags _flags, LinkMatcher const& _matcher);
+
     LinkBase(LinkBase&&) noexcept;
     LinkBase& operator=(LinkBase&&) noexcept;
+
+    std::size_t getMatcherMemoryUsage() const;
+
 private:
+    friend struct Node;
+
     Flags flags {Flags::Optional};
-    std::regex regex;
-    std::string regexStr;
+    // if matcher was compiled for this link because the pattern could not be interned
+    bool ownsMatcher {false};
+    LinkMatcher const* matcher {nullptr};
     Node* owner {nullptr};
+    // the links of owner form an intrusive list
+    LinkBase* prevLink {nullptr};
+    LinkBase* nextLink {nullptr};
 };
 
+namespace detail {
+// bytes a string allocates in addition to its own size
+inline std::size_t heapUsage(std::string const& str) {
+    auto self = reinterpret_cast<char const*>(&str);
+    std::less<char const*> less;
+    if (not less(str.data(), self) and less(str.data(), self + sizeof(str))) {
+        return 0; // short string optimization
+    }
+    return str.capacity() + 1;
+}
+}
+
 template<typename T=Node>
 struct Link : LinkBase {
 private:
@@ -94,6 +240,10 @@ public:
         return node;
     }
 
+    std::size_t getMemoryUsage() const override {
+        return sizeof(*this) + detail::heapUsage(otherName) + getMatcherMemoryUsage();
+    }
+
     bool isConnectedTo(Node const* other) const override {
         return other == dynamic_cast<Node const*>(node);
     }
@@ -162,6 +312,19 @@ public:
         return false;
     }
 
+    bool acceptsMultiple() const override {
+        return true;
+    }
+
+    std::size_t getMemoryUsage() const override {
+        std::size_t usage = sizeof(*this) + getMatcherMemoryUsage();
+        for (auto const& [name, other] : nodes) {
+            // a tree node has three pointers and a color in addition to its value
+            usage += 4 * sizeof(void*) + sizeof(typename decltype(nodes)::value_type) + detail::heapUsage(name);
+        }
+        return usage;
+    }
+
     bool isConnectedTo(Node const* other) const override {
         auto it = std::find_if(nodes.begin(), nodes.end(), [&](auto o) { return other == dynamic_cast<Node const*>(o.second);});
         return it != nodes.end();
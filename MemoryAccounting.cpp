@@ -0,0 +1,199 @@
+#include "MemoryAccounting.h"
+#include "Node.h"
+#include "Tngl.h"
+
+#include <cstdlib>
+#include <new>
+#include <ostream>
+
+namespace tngl {
+
+namespace {
+
+thread_local MemoryAccount* currentAccount {nullptr};
+
+}
+
+bool isMemoryAccountingEnabled() {
+#ifdef TNGL_MEMORY_ACCOUNTING
+    return true;
+#else
+    return false;
+#endif
+}
+
+MemoryAccount* MemoryAccount::create() {
+    return new MemoryAccount;
+}
+
+void MemoryAccount::release(MemoryAccount* account) {
+    if (account and account->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete account;
+    }
+}
+
+MemoryUsage MemoryAccount::getUsage() const {
+    MemoryUsage usage;
+    usage.currentBytes  = currentBytes.load(std::memory_order_relaxed);
+    usage.peakBytes     = peakBytes.load(std::memory_order_relaxed);
+    usage.allocations   = allocations.load(std::memory_order_relaxed);
+    usage.deallocations = deallocations.load(std::memory_order_relaxed);
+    return usage;
+}
+
+void MemoryAccount::recordAllocation(std::size_t size) {
+    references.fetch_add(1, std::memory_order_relaxed);
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    auto current = currentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    auto peak = peakBytes.load(std::memory_order_relaxed);
+    while (peak < current and not peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {}
+}
+
+void MemoryAccount::recordDeallocation(std::size_t size) {
+    deallocations.fetch_add(1, std::memory_order_relaxed);
+    currentBytes.fetch_sub(size, std::memory_order_relaxed);
+    release(this);
+}
+
+MemoryScope::MemoryScope(MemoryAccount* account)
+    : previous{currentAccount}
+{
+    if (account) {
+        currentAccount = account;
+    }
+}
+
+MemoryScope::MemoryScope(Node const& node)
+    : MemoryScope(node.getMemoryAccount())
+{}
+
+MemoryScope::MemoryScope(Unaccounted)
+    : previous{currentAccount}
+{
+    currentAccount = nullptr;
+}
+
+MemoryScope::~MemoryScope() {
+    currentAccount = previous;
+}
+
+namespace detail {
+void releaseMemoryAccount(MemoryAccount* account) {
+    MemoryAccount::release(account);
+}
+}
+
+void writeMemorySnapshot(std::ostream& out, MemorySnapshot const& snapshot) {
+    for (auto const& [name, usage] : snapshot) {
+        out << name << " " << usage.currentBytes << " " << usage.peakBytes << " " << usage.allocations << " " << usage.deallocations << "\n";
+    }
+}
+
+MemorySnapshotExporter::MemorySnapshotExporter(Tngl const& tngl, std::chrono::milliseconds interval, Exporter exporter)
+    : thread{[this, &tngl, interval, exporter] {
+        std::unique_lock lock{mutex};
+        while (not stopCondition.wait_for(lock, interval, [&] { return stopped; })) {
+            exporter(tngl.getMemoryUsage());
+        }
+    }}
+{}
+
+MemorySnapshotExporter::~MemorySnapshotExporter() {
+    {
+        std::lock_guard lock{mutex};
+        stopped = true;
+    }
+    stopCondition.notify_all();
+    thread.join();
+}
+
+}
+
+#ifdef TNGL_MEMORY_ACCOUNTING
+
+namespace {
+
+// precedes every allocation, it keeps the allocation at the alignment malloc guarantees
+struct alignas(alignof(std::max_align_t)) AllocationHeader {
+    tngl::MemoryAccount* account;
+    std::size_t size;
+};
+
+std::size_t headerSpace(std::size_t alignment) {
+    return alignment > sizeof(AllocationHeader) ? alignment : sizeof(AllocationHeader);
+}
+
+void* allocate(std::size_t size, std::size_t alignment) noexcept {
+    auto space = headerSpace(alignment);
+    void* raw {nullptr};
+    if (alignment > alignof(std::max_align_t)) {
+        if (posix_memalign(&raw, alignment, space + size) != 0) {
+            raw = nullptr;
+        }
+    } else {
+        raw = std::malloc(space + size);
+    }
+    if (not raw) {
+        return nullptr;
+    }
+    auto ptr = static_cast<char*>(raw) + space;
+    auto header = reinterpret_cast<AllocationHeader*>(ptr) - 1;
+    header->account = tngl::currentAccount;
+    header->size = size;
+    if (header->account) {
+        header->account->recordAllocation(size);
+    }
+    return ptr;
+}
+
+void* allocateOrThrow(std::size_t size, std::size_t alignment) {
+    while (true) {
+        if (auto ptr = allocate(size, alignment)) {
+            return ptr;
+        }
+        auto handler = std::get_new_handler();
+        if (not handler) {
+            throw std::bad_alloc{};
+        }
+        handler();
+    }
+}
+
+void deallocate(void* ptr, std::size_t alignment) noexcept {
+    if (not ptr) {
+        return;
+    }
+    auto header = static_cast<AllocationHeader*>(ptr) - 1;
+    if (header->account) {
+        header->account->recordDeallocation(header->size);
+    }
+    std::free(static_cast<char*>(ptr) - headerSpace(alignment));
+}
+
+constexpr std::size_t defaultAlignment = alignof(std::max_align_t);
+
+}
+
+void* operator new(std::size_t size) { return allocateOrThrow(size, defaultAlignment); }
+void* operator new[](std::size_t size) { return allocateOrThrow(size, defaultAlignment); }
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept { return allocate(size, defaultAlignment); }
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept { return allocate(size, defaultAlignment); }
+void* operator new(std::size_t size, std::align_val_t al) { return allocateOrThrow(size, static_cast<std::size_t>(al)); }
+void* operator new[](std::size_t size, std::align_val_t al) { return allocateOrThrow(size, static_cast<std::size_t>(al)); }
+void* operator new(std::size_t size, std::align_val_t al, std::nothrow_t const&) noexcept { return allocate(size, static_cast<std::size_t>(al)); }
+void* operator new[](std::size_t size, std::align_val_t al, std::nothrow_t const&) noexcept { return allocate(size, static_cast<std::size_t>(al)); }
+
+void operator delete(void* ptr) noexcept { deallocate(ptr, defaultAlignment); }
+void operator delete[](void* ptr) noexcept { deallocate(ptr, defaultAlignment); }
+void operator delete(void* ptr, std::nothrow_t const&) noexcept { deallocate(ptr, defaultAlignment); }
+void operator delete[](void* ptr, std::nothrow_t const&) noexcept { deallocate(ptr, defaultAlignment); }
+void operator delete(void* ptr, std::size_t) noexcept { deallocate(ptr, defaultAlignment); }
+void operator delete[](void* ptr, std::size_t) noexcept { deallocate(ptr, defaultAlignment); }
+void operator delete(void* ptr, std::align_val_t al) noexcept { deallocate(ptr, static_cast<std::size_t>(al)); }
+void operator delete[](void* ptr, std::align_val_t al) noexcept { deallocate(ptr, static_cast<std::size_t>(al)); }
+void operator delete(void* ptr, std::align_val_t al, std::nothrow_t const&) noexcept { deallocate(ptr, static_cast<std::size_t>(al)); }
+void operator delete[](void* ptr, std::align_val_t al, std::nothrow_t const&) noexcept { deallocate(ptr, static_cast<std::size_t>(al)); }
+void operator delete(void* ptr, std::size_t, std::align_val_t al) noexcept { deallocate(ptr, static_cast<std::size_t>(al)); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t al) noexcept { deallocate(ptr, static_cast<std::size_t>(al)); }
+
+#endif
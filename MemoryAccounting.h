@@ -0,0 +1,84 @@
+#pragma once
+
+#include "MemoryUsage.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <thread>
+
+namespace tngl {
+
+struct Node;
+struct Tngl;
+
+// Allocations are recorded only if MemoryAccounting.cpp is compiled with TNGL_MEMORY_ACCOUNTING.
+// That replaces the global operator new and delete, every allocation then carries the account that was active
+// when it was made, so freeing it is attributed correctly no matter which thread or scope does it.
+bool isMemoryAccountingEnabled();
+
+// the allocations of one node, it lives until it is released and all of its allocations are freed
+struct MemoryAccount {
+    static MemoryAccount* create();
+    static void release(MemoryAccount* account);
+
+    MemoryUsage getUsage() const;
+
+    void recordAllocation(std::size_t size);
+    void recordDeallocation(std::size_t size);
+
+private:
+    MemoryAccount() = default;
+
+    std::atomic<std::size_t> currentBytes {0};
+    std::atomic<std::size_t> peakBytes {0};
+    std::atomic<std::size_t> allocations {0};
+    std::atomic<std::size_t> deallocations {0};
+    // one for the owner and one for each allocation that is not freed yet
+    std::atomic<std::size_t> references {1};
+};
+
+// attributes all allocations of the current thread to account while it is alive
+// a scope for nullptr keeps the account that is active already
+struct MemoryScope {
+    // attributes allocations to no account, for caches that outlive the node whose creation fills them
+    struct Unaccounted {};
+
+    explicit MemoryScope(MemoryAccount* account);
+    explicit MemoryScope(Node const& node);
+    explicit MemoryScope(Unaccounted);
+    ~MemoryScope();
+
+    MemoryScope(MemoryScope const&) = delete;
+    MemoryScope& operator=(MemoryScope const&) = delete;
+
+private:
+    MemoryAccount* previous;
+};
+
+// one line per node: name current peak allocations deallocations
+void writeMemorySnapshot(std::ostream& out, MemorySnapshot const& snapshot);
+
+// hands a snapshot of the memory usage of tngl to exporter every interval until it is destroyed
+// tngl must outlive the exporter
+struct MemorySnapshotExporter {
+    using Exporter = std::function<void(MemorySnapshot const&)>;
+
+    MemorySnapshotExporter(Tngl const& tngl, std::chrono::milliseconds interval, Exporter exporter);
+    ~MemorySnapshotExporter();
+
+    MemorySnapshotExporter(MemorySnapshotExporter const&) = delete;
+    MemorySnapshotExporter& operator=(MemorySnapshotExporter const&) = delete;
+
+private:
+    std::mutex mutex;
+    std::condition_variable stopCondition;
+    bool stopped {false};
+    std::thread thread;
+};
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+namespace tngl {
+
+struct MemoryUsage {
+    std::size_t currentBytes {0};
+    std::size_t peakBytes {0};
+    std::size_t allocations {0};
+    std::size_t deallocations {0};
+};
+
+// memory usage by node name
+using MemorySnapshot = std::map<std::string, MemoryUsage>;
+
+}
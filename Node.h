@@ -1,33 +1,125 @@
 #pragma once
 
+#include "Link.h"
+
 #include <algorithm>
+#include <cstddef>
+#include <iterator>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace tngl {
 
-struct LinkBase;
+struct MemoryAccount;
+
+namespace detail {
+void releaseMemoryAccount(MemoryAccount* account);
+}
 
 struct Node {
 private:
-	std::vector<LinkBase*> links;
+	// intrusive list of all links that belong to this node, adding and removing a link is O(1)
+	LinkBase* firstLink {nullptr};
+	LinkBase* lastLink {nullptr};
+	MemoryAccount* memoryAccount {nullptr};
 
 public:
-	virtual ~Node() = default;
+	struct LinkIterator {
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = LinkBase*;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = LinkBase* const*;
+		using reference         = LinkBase*;
+
+		LinkBase* link {nullptr};
+
+		LinkBase* operator*() const {
+			return link;
+		}
+		LinkIterator& operator++() {
+			link = link->nextLink;
+			return *this;
+		}
+		LinkIterator operator++(int) {
+			auto it = *this;
+			++*this;
+			return it;
+		}
+		bool operator==(LinkIterator const& other) const {
+			return link == other.link;
+		}
+		bool operator!=(LinkIterator const& other) const {
+			return link != other.link;
+		}
+	};
+
+	struct LinkRange {
+		LinkBase* first {nullptr};
+
+		LinkIterator begin() const {
+			return {first};
+		}
+		LinkIterator end() const {
+			return {};
+		}
+		bool empty() const {
+			return first == nullptr;
+		}
+	};
+
+	Node() = default;
+	// links register themselves at the node they are a member of, hence they are never copied along
+	Node(Node const&) {}
+	Node& operator=(Node const&) {
+		return *this;
+	}
+	virtual ~Node() {
+		detail::releaseMemoryAccount(memoryAccount);
+	}
 
 	virtual void initializeNode() {};
 	virtual void deinitializeNode() noexcept {};
 
-	auto getLinks() const -> decltype(links) const& {
-		return links;
+	LinkRange getLinks() const {
+		return {firstLink};
+	}
+
+	// the account that MemoryScope{node} attributes allocations to, it is set by Tngl if memory accounting is enabled
+	// the node owns a reference to its account, hence it stays valid as long as the node does
+	MemoryAccount* getMemoryAccount() const {
+		return memoryAccount;
+	}
+	// takes over the reference to account and releases the previous one
+	void setMemoryAccount(MemoryAccount* account) {
+		detail::releaseMemoryAccount(std::exchange(memoryAccount, account));
 	}
 
 	void addLink(LinkBase* link) {
-		links.emplace_back(link);
+		link->prevLink = lastLink;
+		link->nextLink = nullptr;
+		if (lastLink) {
+			lastLink->nextLink = link;
+		} else {
+			firstLink = link;
+		}
+		lastLink = link;
 	}
 	void removeLink(LinkBase* link) {
-		links.erase(std::remove(links.begin(), links.end(), link), links.end());
+		(link->prevLink ? link->prevLink->nextLink : firstLink) = link->nextLink;
+		(link->nextLink ? link->nextLink->prevLink : lastLink) = link->prevLink;
+		link->prevLink = nullptr;
+		link->nextLink = nullptr;
+	}
+	// let replacement take the place of link
+	void replaceLink(LinkBase* link, LinkBase* replacement) {
+		replacement->prevLink = link->prevLink;
+		replacement->nextLink = link->nextLink;
+		(link->prevLink ? link->prevLink->nextLink : firstLink) = replacement;
+		(link->nextLink ? link->nextLink->prevLink : lastLink) = replacement;
+		link->prevLink = nullptr;
+		link->nextLink = nullptr;
 	}
 };
 
@@ -0,0 +1,198 @@
+#include "Planner.h"
+
+#include <algorithm>
+#include <list>
+#include <memory>
+
+namespace tngl {
+
+namespace {
+
+struct DeclaredLink;
+
+// stands in for a seed node or a node that a builder would create
+struct PlannedNode : Node {
+    std::string name;
+    Node const* seed;
+    NodeBuilderBase const* builder;
+    std::list<DeclaredLink> links;
+    // nodes whose pruning unset links of this node
+    std::vector<std::string> lostLinksTo;
+
+    PlannedNode(std::string _name, Node const* _seed, NodeBuilderBase const* _builder)
+        : name{std::move(_name)}
+        , seed{_seed}
+        , builder{_builder}
+    {}
+
+    // if a link of type base can be set to this node
+    bool isA(std::type_info const& base) const {
+        if (builder) {
+            return builder->canProduce(base);
+        }
+        return detail::is_type_ancestor(base, typeid(*seed));
+    }
+};
+
+// a link of a PlannedNode, it behaves like a Link or Links of the declared type
+struct DeclaredLink final : LinkBase {
+    PlannedNode* node;
+    std::string name;
+    std::type_info const* type;
+    bool multiple;
+    // a link of a seed node that was set before planning
+    bool preset;
+    std::vector<Node const*> targets;
+
+    // matcher has to outlive the link
+    DeclaredLink(PlannedNode* _node, std::string _name, Flags flags, LinkMatcher const& matcher, std::type_info const* _type, bool _multiple, bool _preset)
+        : LinkBase(_node, flags, matcher)
+        , node{_node}
+        , name{std::move(_name)}
+        , type{_type}
+        , multiple{_multiple}
+        , preset{_preset}
+    {}
+
+    DeclaredLink(PlannedNode* _node, std::string _name, Flags flags, std::string const& pattern, std::type_info const* _type, bool _multiple, bool _preset)
+        : LinkBase(_node, flags, pattern)
+        , node{_node}
+        , name{std::move(_name)}
+        , type{_type}
+        , multiple{_multiple}
+        , preset{_preset}
+    {}
+
+    std::type_info const& getType() const override {
+        return *type;
+    }
+    bool canSetOther(Node const* other) const override {
+        if (auto planned = dynamic_cast<PlannedNode const*>(other)) {
+            return planned->isA(*type);
+        }
+        // a node of a parent container
+        return detail::is_type_ancestor(*type, typeid(*other));
+    }
+    void setOther(Node* other, std::string const&) override {
+        if (not canSetOther(other)) {
+            return;
+        }
+        if (not multiple) {
+            targets = {other};
+        } else if (not isConnectedTo(other)) {
+            targets.emplace_back(other);
+        }
+    }
+    void unset(Node const* other) override {
+        auto it = std::find(targets.begin(), targets.end(), other);
+        if (it == targets.end()) {
+            return;
+        }
+        targets.erase(it);
+        // only planned nodes get pruned
+        auto const& otherName = static_cast<PlannedNode const*>(other)->name;
+        auto& lost = node->lostLinksTo;
+        if (std::find(lost.begin(), lost.end(), otherName) == lost.end()) {
+            lost.emplace_back(otherName);
+        }
+    }
+    bool satisfied() const override {
+        return not multiple and (preset or not targets.empty());
+    }
+    bool acceptsMultiple() const override {
+        return multiple;
+    }
+    bool isConnectedTo(Node const* other) const override {
+        return std::find(targets.begin(), targets.end(), other) != targets.end();
+    }
+};
+
+}
+
+// runs the construction of Tngl with planned nodes and records what happens
+struct Planner {
+    Plan result;
+    // seed nodes are copied, the originals are not touched and outlive the plan
+    std::list<PlannedNode> seedNodes;
+
+    void addSeedNode(std::string const& name, Node const* seed) {
+        auto& node = seedNodes.emplace_back(name, seed, nullptr);
+        for (auto link : seed->getLinks()) {
+            node.links.emplace_back(&node, link->getRegex(), link->getFlags(), link->getMatcher(), &link->getType(), link->acceptsMultiple(), link->satisfied());
+        }
+    }
+
+    std::unique_ptr<Node> create(std::string const& name, NodeBuilderBase const& builder) {
+        result.creationOrder.emplace_back(Plan::Creation{name, &builder});
+        auto node = std::make_unique<PlannedNode>(name, nullptr, &builder);
+        if (auto declarations = builder.getLinkDeclarations()) {
+            auto matchers = builder.getLinkMatchers();
+            for (auto const& declaration : *declarations) {
+                // the builder outlives the plan and with it its matchers
+                if (matchers) {
+                    auto const& matcher = *matchers[&declaration - declarations->begin()];
+                    node->links.emplace_back(node.get(), declaration.name, declaration.flags, matcher, declaration.type, declaration.multiple, false);
+                } else {
+                    node->links.emplace_back(node.get(), declaration.name, declaration.flags, std::string{declaration.pattern}, declaration.type, declaration.multiple, false);
+                }
+            }
+        } else {
+            result.undeclaredBuilders.emplace_back(name);
+        }
+        return node;
+    }
+
+    void handleError(std::exception const& error) {
+        // builders are not called, hence links that cannot be satisfied are the only errors
+        auto notSatisfied = dynamic_cast<NodeLinksNotSatisfiedError const*>(&error);
+        if (not notSatisfied) {
+            return;
+        }
+        auto node = static_cast<PlannedNode const*>(notSatisfied->node);
+        std::vector<Plan::UnsatisfiedLink> unsatisfied;
+        for (auto link : notSatisfied->unsatisfiedLinks) {
+            unsatisfied.emplace_back(Plan::UnsatisfiedLink{node->name, static_cast<DeclaredLink const*>(link)->name, link->getRegex()});
+        }
+        if (node->seed) {
+            result.unsatisfiedLinks.insert(result.unsatisfiedLinks.end(), unsatisfied.begin(), unsatisfied.end());
+        } else {
+            result.prunedNodes.emplace_back(Plan::PrunedNode{node->name, std::move(unsatisfied), node->lostLinksTo});
+        }
+    }
+
+    void run(Tngl::Pimpl const* parent, std::map<std::string, Node*> const& seeds, NodeBuilders const& nodeBuilders) {
+        std::map<std::string, Node*> plannedSeeds;
+        for (auto const& [name, seed] : seeds) {
+            addSeedNode(name, seed);
+            plannedSeeds.emplace(name, &seedNodes.back());
+        }
+        Tngl tngl{parent, plannedSeeds,
+            [this](std::exception const& error) { handleError(error); },
+            nodeBuilders,
+            [this](std::string const& name, NodeBuilderBase const& builder) { return create(name, builder); }};
+
+        for (auto const& [name, node] : tngl.getNodes()) {
+            // the nodes of the parent are not planned
+            auto planned = dynamic_cast<PlannedNode const*>(node);
+            if (planned and planned->builder) {
+                result.chosenBuilders.emplace(name, planned->builder);
+            }
+        }
+    }
+
+    static Plan plan(Tngl const* parent, std::map<std::string, Node*> const& seeds, NodeBuilders const& nodeBuilders) {
+        Planner planner;
+        planner.run(parent ? parent->pimpl.get() : nullptr, seeds, nodeBuilders);
+        return std::move(planner.result);
+    }
+};
+
+Plan plan(std::map<std::string, Node*> const& seedNodes, NodeBuilders const& nodeBuilders) {
+    return Planner::plan(nullptr, seedNodes, nodeBuilders);
+}
+
+Plan plan(Tngl const& parent, std::map<std::string, Node*> const& seedNodes, NodeBuilders const& nodeBuilders) {
+    return Planner::plan(&parent, seedNodes, nodeBuilders);
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Factory.h"
+#include "Link.h"
+#include "Node.h"
+#include "Tngl.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace tngl {
+
+// The outcome of constructing a Tngl without calling any builder.
+// Planning runs the construction of Tngl with stand-ins: created nodes are described by the link declarations of their builders,
+// seed nodes by copies of their actual links. Nodes of a parent container are used as they are.
+// Builders cannot fail during planning, a builder that returns no node in Tngl is planned as if it succeeded.
+struct Plan {
+    struct Creation {
+        std::string name;
+        NodeBuilderBase const* builder;
+    };
+
+    struct UnsatisfiedLink {
+        std::string node;
+        // the declared name of the link, the pattern for links of seed nodes
+        std::string link;
+        std::string pattern;
+    };
+
+    struct PrunedNode {
+        std::string name;
+        std::vector<UnsatisfiedLink> unsatisfiedLinks;
+        // the previously pruned nodes whose removal left links of this node unsatisfied
+        std::vector<std::string> prunedBecauseOf;
+    };
+
+    // all builders in the order Tngl would call them, including those of nodes that get pruned
+    std::vector<Creation> creationOrder;
+    // the builders of the nodes that remain
+    std::map<std::string, NodeBuilderBase const*> chosenBuilders;
+    // the required links of seed nodes that cannot be satisfied
+    std::vector<UnsatisfiedLink> unsatisfiedLinks;
+    // nodes with unsatisfied required links in the order they get dropped
+    std::vector<PrunedNode> prunedNodes;
+    // builders in creationOrder that do not declare their links, they are planned as if their nodes had no links
+    std::vector<std::string> undeclaredBuilders;
+
+    // if every planned node was described by the declarations of its builder
+    bool isComplete() const {
+        return undeclaredBuilders.empty();
+    }
+
+    // a Tngl constructed from the same inputs satisfies all required links of its seed nodes unless a builder fails
+    // links of seed nodes to pruned nodes are unset before that is checked, hence they count as unsatisfied
+    bool isValid() const {
+        return isComplete() and unsatisfiedLinks.empty();
+    }
+};
+
+// does not modify seedNodes or nodeBuilders, hence plans can be made concurrently
+Plan plan(std::map<std::string, Node*> const& seedNodes, NodeBuilders const& nodeBuilders = NodeBuilderRegistry::getInstance());
+// plans a child container of parent
+Plan plan(Tngl const& parent, std::map<std::string, Node*> const& seedNodes, NodeBuilders const& nodeBuilders = NodeBuilderRegistry::getInstance());
+
+}
@@ -0,0 +1,132 @@
+#include "Plugin.h"
+#include "MemoryAccounting.h"
+
+#include <dlfcn.h>
+
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace tngl {
+
+namespace {
+
+std::string const manifestExtension = ".tngl";
+
+// gcc prefixes names of types with internal linkage with a '*'
+std::string typeName(std::type_info const& info) {
+    char const* name = info.name();
+    return name[0] == '*' ? name + 1 : name;
+}
+
+}
+
+struct PluginLibrary {
+    std::string path;
+    std::mutex mutex;
+    void* handle {nullptr};
+    // the builders the library registered while it got loaded, they are not in the NodeBuilderRegistry
+    NodeBuilders builders;
+
+    PluginLibrary(std::string _path)
+        : path{std::move(_path)}
+    {}
+
+    void load() {
+        std::lock_guard lock{mutex};
+        if (handle) {
+            return;
+        }
+        // the library is never closed again since nodes created by it might outlive every Tngl
+        // it is loaded by the creation of a node but belongs to the process
+        MemoryScope scope{MemoryScope::Unaccounted{}};
+        detail::RegistrationCapture capture{builders};
+        handle = dlopen(path.c_str(), RTLD_NOW | RTLD_GLOBAL);
+        if (not handle) {
+            throw std::runtime_error("cannot load plugin \"" + path + "\": " + dlerror());
+        }
+    }
+};
+
+PluginBuilder::PluginBuilder(std::string name, std::vector<std::string> types, std::shared_ptr<PluginLibrary> library)
+    : RegisteredNodeBuilder(std::move(name), typeid(Node))
+    , _types{std::move(types)}
+    , _library{std::move(library)}
+{}
+
+std::unique_ptr<Node> PluginBuilder::create() const {
+    _library->load();
+    auto const& name = getName();
+    // the builders of a loaded library do not change anymore
+    auto [first, last] = _library->builders.equal_range(name);
+    auto it = std::find_if(first, last, [](auto const& pair) {
+        return not dynamic_cast<PluginBuilder const*>(pair.second);
+    });
+    if (it == last) {
+        throw std::runtime_error("plugin \"" + _library->path + "\" does not provide a builder named \"" + name + "\"");
+    }
+    return it->second->create();
+}
+
+bool PluginBuilder::canProduce(std::type_info const& base) const {
+    return std::find(_types.begin(), _types.end(), typeName(base)) != _types.end();
+}
+
+Plugins::Plugins() {
+    // the builders unregister on destruction, hence the registry has to outlive this
+    NodeBuilderRegistry::getInstance();
+}
+
+void Plugins::addManifest(std::string const& manifestPath, std::string libraryPath) {
+    if (libraryPath.empty()) {
+        // a path without a directory would make dlopen search the library path instead of the directory of the manifest
+        libraryPath = std::filesystem::absolute(manifestPath).replace_extension().string();
+    }
+    std::ifstream manifest{manifestPath};
+    if (not manifest) {
+        throw std::runtime_error("cannot read plugin manifest \"" + manifestPath + "\"");
+    }
+    auto library = std::make_shared<PluginLibrary>(libraryPath);
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (line.empty() or line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields{line};
+        std::string name;
+        std::getline(fields, name, '\t');
+        std::vector<std::string> types;
+        for (std::string type; std::getline(fields, type, '\t');) {
+            types.emplace_back(std::move(type));
+        }
+        builders.emplace_back(std::make_unique<PluginBuilder>(std::move(name), std::move(types), library));
+    }
+}
+
+void Plugins::addDirectory(std::string const& path) {
+    for (auto const& entry : std::filesystem::directory_iterator{path}) {
+        if (entry.is_regular_file() and entry.path().extension() == manifestExtension) {
+            addManifest(entry.path().string());
+        }
+    }
+}
+
+void writeManifest(std::ostream& out, std::string const& libraryPath) {
+    // the builders of the library unregister from it when the process exits, hence it is kept until then
+    static std::vector<std::shared_ptr<PluginLibrary>> libraries;
+    auto library = libraries.emplace_back(std::make_shared<PluginLibrary>(libraryPath));
+    library->load();
+    out << "# tngl manifest of " << libraryPath << "\n";
+    for (auto const& [name, builder] : library->builders) {
+        out << name;
+        for (auto type : detail::type_ancestors(builder->getType())) {
+            out << '\t' << typeName(*type);
+        }
+        out << "\n";
+    }
+}
+
+}
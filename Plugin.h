@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Factory.h"
+#include "Singleton.h"
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tngl {
+
+// A plugin is a shared library that comes with a manifest file.
+// The manifest lists the builders of the library, one per line:
+//     <builder name>\t<mangled type>[\t<mangled type>...]
+// where the types are the type produced by the builder and all of its base classes.
+// Lines that are empty or start with '#' are ignored.
+// The library is only loaded when one of its builders is selected to create a node.
+// Plugins register their builders through the executable, hence it has to export its symbols (-rdynamic).
+// Their builders are kept apart from the NodeBuilderRegistry and are only reachable through the manifest,
+// hence loading a plugin does not race with Tngls that are constructed concurrently.
+
+struct PluginLibrary;
+
+// stands in for a builder of a plugin that might not be loaded yet
+struct PluginBuilder : RegisteredNodeBuilder {
+    PluginBuilder(std::string name, std::vector<std::string> types, std::shared_ptr<PluginLibrary> library);
+
+    // loads the library and forwards to the builder it registered under the same name
+    std::unique_ptr<Node> create() const override;
+
+    bool canProduce(std::type_info const& base) const override;
+
+private:
+    std::vector<std::string> _types;
+    std::shared_ptr<PluginLibrary> _library;
+};
+
+struct Plugins {
+    Plugins();
+
+    // register the builders of the manifest at manifestPath, like any builder this must not race with the construction of a Tngl
+    // libraryPath defaults to manifestPath without its ".tngl" extension
+    void addManifest(std::string const& manifestPath, std::string libraryPath = "");
+
+    // register all manifests (files ending in ".tngl") of a directory
+    void addDirectory(std::string const& path);
+
+private:
+    std::vector<std::unique_ptr<PluginBuilder>> builders;
+};
+using PluginRegistry = Singleton<Plugins>;
+
+// load the library at libraryPath and write the manifest for all builders it registers
+void writeManifest(std::ostream& out, std::string const& libraryPath);
+
+}
@@ -1,44 +1,136 @@
 #include "Tngl.h"
+#include "MemoryAccounting.h"
 
 #include <map>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <regex>
 #include <iostream>
+#include <unordered_map>
 
 namespace tngl {
 
 struct Tngl::Pimpl {
+    using Matches = std::vector<std::pair<std::string const*, Node*>>;
+
+    Pimpl const* parent {nullptr};
     std::map<std::string, Node*> seedNodes;
     std::multimap<std::string, std::unique_ptr<Node>> nodes;
+
+    // all nodes of the finished container, child containers resolve their links against this
+    std::multimap<std::string, Node*> index;
+    mutable std::mutex matchesMutex;
+    mutable std::map<std::string, Matches> matchesCache;
+
+    bool isInAncestors(std::string const& name) const {
+        for (auto p = parent; p; p = p->parent) {
+            if (p->index.find(name) != p->index.end()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void linkToAncestors(LinkBase& link) const {
+        for (auto p = parent; p and not link.satisfied(); p = p->parent) {
+            p->linkToIndex(link);
+        }
+    }
+
+    void linkToIndex(LinkBase& link) const {
+        auto const& regex = link.getRegex();
+        if (link.getMatcher().isLiteral()) {
+            auto [first, last] = index.equal_range(regex);
+            for (; first != last and not link.satisfied(); ++first) {
+                link.setOther(first->second, first->first);
+            }
+            return;
+        }
+        // the index never changes once built, hence the matches of a regex can be remembered for all children
+        Matches const* matches;
+        {
+            std::lock_guard lock{matchesMutex};
+            auto it = matchesCache.find(regex);
+            if (it == matchesCache.end()) {
+                Matches newMatches;
+                for (auto const& [name, node] : index) {
+                    if (link.matchesName(name)) {
+                        newMatches.emplace_back(&name, node);
+                    }
+                }
+                it = matchesCache.emplace(regex, std::move(newMatches)).first;
+            }
+            matches = &it->second;
+        }
+        for (auto const& [name, node] : *matches) {
+            link.setOther(node, *name);
+            if (link.satisfied()) {
+                break;
+            }
+        }
+    }
 };
 
 
 Tngl::Tngl(Node& seedNode, std::string const& seedNodeName, ExceptionHandler const& errorHandler, NodeBuilders const& nodeBuilders)
     : Tngl({{seedNodeName, &seedNode}}, errorHandler, nodeBuilders)
 {}
-Tngl::Tngl(std::map<std::string, Node*> const& seedNodes, ExceptionHandler const& errorHandler, NodeBuilders const& nodeBuilders) 
+Tngl::Tngl(std::map<std::string, Node*> const& seedNodes, ExceptionHandler const& errorHandler, NodeBuilders const& nodeBuilders)
+    : Tngl(nullptr, seedNodes, errorHandler, nodeBuilders)
+{}
+Tngl::Tngl(Tngl const& parent, Node& seedNode, std::string const& seedNodeName, ExceptionHandler const& errorHandler, NodeBuilders const& nodeBuilders)
+    : Tngl(parent, {{seedNodeName, &seedNode}}, errorHandler, nodeBuilders)
+{}
+Tngl::Tngl(Tngl const& parent, std::map<std::string, Node*> const& seedNodes, ExceptionHandler const& errorHandler, NodeBuilders const& nodeBuilders)
+    : Tngl(parent.pimpl.get(), seedNodes, errorHandler, nodeBuilders)
+{}
+Tngl::Tngl(Pimpl const* parent, std::map<std::string, Node*> const& seedNodes, ExceptionHandler const& errorHandler, NodeBuilders const& nodeBuilders, Creator const& creator)
     : pimpl{std::make_unique<Pimpl>()}
 {
     auto& nodes = pimpl->nodes;
 
+    pimpl->parent = parent;
     pimpl->seedNodes = seedNodes;
 
-    // hook the seed nodes together
-    for (auto& [name, sn] : pimpl->seedNodes) {
-        for (auto& link : sn->getLinks()) {
+    // nodes of a planner allocate nothing worth accounting for
+    bool const accountMemory = isMemoryAccountingEnabled() and not creator;
+    if (accountMemory) {
+        for (auto& [name, seedNode] : pimpl->seedNodes) {
+            // a seed node might be shared with other containers, the first one accounts for it
+            // the account belongs to the seed node, hence the container never touches it again
+            if (not seedNode->getMemoryAccount()) {
+                seedNode->setMemoryAccount(MemoryAccount::create());
+            }
+        }
+    }
+
+    // set link to the nodes of this container first and to the nodes of the ancestors after that
+    auto linkToKnownNodes = [&](LinkBase* link) {
+        for (auto& [name, node] : pimpl->seedNodes) {
             if (link->satisfied()) {
-                continue;
+                return;
             }
-            for (auto& [peerName, peer] : pimpl->seedNodes) {
-                if (link->matchesName(peerName)) {
-                    link->setOther(peer, peerName);
-                    if (link->satisfied()) {
-                        break;
-                    }
-                }
+            if (link->matchesName(name)) {
+                link->setOther(node, name);
             }
         }
+        for (auto& [name, node] : nodes) {
+            if (link->satisfied()) {
+                return;
+            }
+            if (link->matchesName(name)) {
+                link->setOther(node.get(), name);
+            }
+        }
+        pimpl->linkToAncestors(*link);
+    };
+
+    // hook the seed nodes together
+    for (auto& [name, sn] : pimpl->seedNodes) {
+        for (auto link : sn->getLinks()) {
+            linkToKnownNodes(link);
+        }
     }
 
     std::vector<LinkBase*> links;
@@ -46,40 +138,61 @@ Tngl::Tngl(std::map<std::string, Node*> const& seedNodes, ExceptionHandler const
         return not link->satisfied() and (link->getFlags() & Flags::CreateIfNotExist) == Flags::CreateIfNotExist;
     };
     for (auto const& [name, seedNode] : pimpl->seedNodes) {
-        std::copy(begin(seedNode->getLinks()), end(seedNode->getLinks()), std::back_inserter(links));
+        std::copy(seedNode->getLinks().begin(), seedNode->getLinks().end(), std::back_inserter(links));
     };
     std::set<std::string> brokenBuilders;
 
+    // the builders whose name matches a matcher, links share them through their interned matcher
+    using Candidates = std::vector<std::pair<std::string, NodeBuilderBase const*>>;
+    std::unordered_map<LinkMatcher const*, Candidates> candidatesCache;
+    auto getCandidates = [&](LinkMatcher const& matcher) -> Candidates const& {
+        auto it = candidatesCache.find(&matcher);
+        if (it == candidatesCache.end()) {
+            it = candidatesCache.emplace(&matcher, findNodeBuilders(nodeBuilders, matcher)).first;
+        }
+        return it->second;
+    };
+
     auto findCreatorForLink = [&](LinkBase const* link) {
-        return std::find_if(nodeBuilders.begin(), nodeBuilders.end(), [&](auto const& creator) {
-            return  link->matchesName(creator.first) and // if the name matches
-                    brokenBuilders.find(creator.first) == brokenBuilders.end() and // if we did not try to create it before
-                    nodes.find(creator.first) == nodes.end() and // if it is not created yet
-                    detail::is_type_ancestor(link->getType(), creator.second->getType()); // if it produces the right type
-        });
+        for (auto const& creator : getCandidates(link->getMatcher())) { // if the name matches
+            if (brokenBuilders.find(creator.first) == brokenBuilders.end() and // if we did not try to create it before
+                nodes.find(creator.first) == nodes.end() and // if it is not created yet
+                not pimpl->isInAncestors(creator.first) and // if no ancestor provides it already
+                creator.second->canProduce(link->getType())) { // if it produces the right type
+                return &creator;
+            }
+        }
+        return static_cast<Candidates::value_type const*>(nullptr);
     };
 
     while (true) {
         // find a link that can be set
         auto linkIt = std::find_if(links.begin(), links.end(), [&](LinkBase const* link) {
-            return isUnsatisfied(link) and findCreatorForLink(link) != nodeBuilders.end();
+            return isUnsatisfied(link) and findCreatorForLink(link);
         });
         if (linkIt == links.end()) {
             break; // we've exhausted the things to create
         }
         auto creatorIt = findCreatorForLink(*linkIt);
-        if (creatorIt == nodeBuilders.end()) {
+        if (not creatorIt) {
             // if at one point we decided to build a node but cannot do so now something is terribly broken
             throw std::runtime_error("fatal internal error");
         }
+        if (not creator) {
+            detail::selectNodeBuilder(nodeBuilders, creatorIt->first, creatorIt->second);
+        }
         // build the new node
         std::unique_ptr<Node> newNode;
+        MemoryAccount* account = accountMemory ? MemoryAccount::create() : nullptr;
         try {
-            newNode = creatorIt->second->create();
+            MemoryScope scope{account};
+            newNode = creator ? creator(creatorIt->first, *creatorIt->second) : creatorIt->second->create();
             if (not newNode) {
                 throw std::runtime_error("cannot create node with name: \"" + creatorIt->first + "\"");
             }
+            newNode->setMemoryAccount(account);
         } catch (...) {
+            MemoryAccount::release(account);
             brokenBuilders.insert(creatorIt->first);
             try {
                 std::throw_with_nested(NodeNotCreatableError{creatorIt->first, "cannot create: \"" + creatorIt->first + "\""});
@@ -102,28 +215,10 @@ Tngl::Tngl(std::map<std::string, Node*> const& seedNodes, ExceptionHandler const
         }
         // set the links of newNode to everything we have created so far
         for (auto link : newNode->getLinks()) {
-            for (auto& [name, node] : pimpl->seedNodes) {
-                if (link->matchesName(name)) {
-                    link->setOther(node, name);
-                    if (link->satisfied()) {
-                        break;
-                    }
-                }
-            }
-            if (link->satisfied()) {
-                break;
-            }
-            for (auto& node : nodes) {
-                if (link->matchesName(node.first)) {
-                    link->setOther(node.second.get(), node.first);
-                    if (link->satisfied()) {
-                        break;
-                    }
-                }
-            }
+            linkToKnownNodes(link);
         }
         // put all new links into the set of all links
-        std::copy(begin(newNode->getLinks()), end(newNode->getLinks()), std::back_inserter(links));
+        std::copy(newNode->getLinks().begin(), newNode->getLinks().end(), std::back_inserter(links));
         nodes.emplace(creatorIt->first, std::move(newNode));
     }
 
@@ -155,6 +250,11 @@ Tngl::Tngl(std::map<std::string, Node*> const& seedNodes, ExceptionHandler const
             break;
         }
         handleBadNode(*it->second.get(), it->first);
+        // seed nodes must not keep links to it either, that might leave a required link of theirs unsatisfied
+        for (auto& [name, seedNode] : pimpl->seedNodes) {
+            auto const& links = seedNode->getLinks();
+            std::for_each(links.begin(), links.end(), [&](auto link) {link->unset(it->second.get());});
+        }
         nodes.erase(it);
     }
     // test if the requires of the seed note are satisfied
@@ -166,6 +266,13 @@ Tngl::Tngl(std::map<std::string, Node*> const& seedNodes, ExceptionHandler const
             }
         }
     }
+
+    for (auto& [name, node] : pimpl->seedNodes) {
+        pimpl->index.emplace(name, node);
+    }
+    for (auto& [name, node] : nodes) {
+        pimpl->index.emplace(name, node.get());
+    }
 }
 
 Tngl::~Tngl() {}
@@ -175,10 +282,14 @@ void Tngl::initialize(ExceptionHandler const& errorHandler) {
     auto initializer = [&](std::string const& name, Node* node) {
         try {
             std::cout << "init: " << name << "\n";
-            node->initializeNode();
+            {
+                MemoryScope scope{*node};
+                node->initializeNode();
+            }
             initialized_nodes.emplace_back(node);
         } catch (...) {
             for (auto* n : initialized_nodes) {
+                MemoryScope scope{*n};
                 n->deinitializeNode();
             }
             try {
@@ -201,15 +312,32 @@ void Tngl::initialize(ExceptionHandler const& errorHandler) {
 void Tngl::deinitialize() {
     for (auto& [name, b] : pimpl->seedNodes) {
         std::cout << "deinit: " << name << "\n";
+        MemoryScope scope{*b};
         b->deinitializeNode();
     }
     for (auto& [name, b] : pimpl->nodes) {
         std::cout << "deinit: " << name << "\n";
+        MemoryScope scope{*b};
         b->deinitializeNode();
     }
 }
 
 
+MemorySnapshot Tngl::getMemoryUsage() const {
+    MemorySnapshot snapshot;
+    for (auto& [name, node] : pimpl->seedNodes) {
+        if (auto account = node->getMemoryAccount()) {
+            snapshot.emplace(name, account->getUsage());
+        }
+    }
+    for (auto& [name, node] : pimpl->nodes) {
+        if (auto account = node->getMemoryAccount()) {
+            snapshot.emplace(name, account->getUsage());
+        }
+    }
+    return snapshot;
+}
+
 std::multimap<std::string, Node*> Tngl::getNodesImpl(std::regex const& regex) const {
     std::multimap<std::string, Node*> nodes;
     for (auto& [name, node] : pimpl->seedNodes) {
@@ -222,6 +350,13 @@ std::multimap<std::string, Node*> Tngl::getNodesImpl(std::regex const& regex) co
             nodes.emplace(name, node.get());
         }
     }
+    for (auto p = pimpl->parent; p; p = p->parent) {
+        for (auto& [name, node] : p->index) {
+            if (std::regex_match(name, regex)) {
+                nodes.emplace(name, node);
+            }
+        }
+    }
     return nodes;
 }
 
@@ -233,6 +368,9 @@ std::multimap<std::string, Node*> Tngl::getNodes() const {
     for (auto& [name, node] : pimpl->nodes) {
         nodes.emplace(name, node.get());
     }
+    for (auto p = pimpl->parent; p; p = p->parent) {
+        nodes.insert(p->index.begin(), p->index.end());
+    }
     return nodes;
 }
 
@@ -3,6 +3,7 @@
 #include "Exceptions.h"
 #include "Factory.h"
 #include "Link.h"
+#include "MemoryUsage.h"
 #include "Node.h"
 
 #include <map>
@@ -12,10 +13,17 @@
 
 namespace tngl {
 
+struct Planner;
+
 struct Tngl final {
     using ExceptionHandler = std::function<void(std::exception const&)>;
     Tngl(Node& seedNode, std::string const& seedNodeName, ExceptionHandler const& errorHandler, NodeBuilders const& nodeBuilders = NodeBuilderRegistry::getInstance());
     Tngl(std::map<std::string, Node*> const& seedNodes, ExceptionHandler const& errorHandler, NodeBuilders const& nodeBuilders = NodeBuilderRegistry::getInstance());
+
+    // child containers only create their own nodes, links that cannot be satisfied by those fall through to the nodes of parent
+    // parent must outlive the child
+    Tngl(Tngl const& parent, Node& seedNode, std::string const& seedNodeName, ExceptionHandler const& errorHandler, NodeBuilders const& nodeBuilders = NodeBuilderRegistry::getInstance());
+    Tngl(Tngl const& parent, std::map<std::string, Node*> const& seedNodes, ExceptionHandler const& errorHandler, NodeBuilders const& nodeBuilders = NodeBuilderRegistry::getInstance());
     ~Tngl();
 
     template <typename T = Node>
@@ -60,9 +68,18 @@ struct Tngl final {
 
     std::multimap<std::string, Node*> getNodes() const;
 
+    // memory usage of the nodes of this container (not of its ancestors), empty unless memory accounting is enabled
+    MemorySnapshot getMemoryUsage() const;
+
 private:
-    std::multimap<std::string, Node*> getNodesImpl(std::regex const& regex) const;
+    friend struct Planner;
     struct Pimpl;
+
+    // creates the node of a selected builder, the planner substitutes nodes that only describe their links
+    using Creator = std::function<std::unique_ptr<Node>(std::string const& name, NodeBuilderBase const& builder)>;
+    Tngl(Pimpl const* parent, std::map<std::string, Node*> const& seedNodes, ExceptionHandler const& errorHandler, NodeBuilders const& nodeBuilders, Creator const& creator = {});
+
+    std::multimap<std::string, Node*> getNodesImpl(std::regex const& regex) const;
     std::unique_ptr<Pimpl> pimpl;
 };
 